@@ -11,14 +11,67 @@
 #include <arpa/inet.h>
 #include <cstring>
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define PORT_MAX 65535
 #define QUERY_LENGTH 200
 #define MSG_LENGTH 2048
+#define TCP_MSG_LENGTH 65535    // maximal length of DNS message over TCP
 #define AABIT           0b0000010000000000
 #define TRUNCATIONBIT   0b0000001000000000
 #define RECURSIONBIT    0b0000000100000000
 #define LABELPOINER     0b11000000
+#define POINTER_LIMIT   128     // compression pointers followed in one name
+#define LABEL_LIMIT     128     // labels of one name remembered in NameMemo
+#define RCODEMASK       0b0000000000001111
+#define RCODE_SERVFAIL  2
+#define RCODE_NXDOMAIN  3
+#define RCODE_REFUSED   5
+#define BULK_TIMEOUT_MS 2000    // longest wait for answer, also used before RTT is known
+#define BULK_RETRIES    3       // resends of timed out or refused query
+#define BULK_POLL_MS    5       // granularity of bulk send loop
+#define PACER_BURST     10      // token bucket capacity
+#define PACER_INIT_WINDOW 4     // starting number of queries in flight
+#define PACER_MAX_WINDOW  512   // upper bound of queries in flight
+#define PACER_RTT_INFLATION 2.0 // RTT above minRtt * this is treated as congestion
+#define PACER_RTT_SLACK_MS  20  // ... but only when it is also this much above minRtt
+#define PACER_MIN_TIMEOUT_MS 50 // lower bound of timeout derived from RTT
+#define PACER_MIN_RTT_WINDOW_MS 10000   // minRtt older than this is replaced, path RTT may have grown
+#define PCAP_MAGIC      0xa1b2c3d4
+#define PCAP_MAGIC_NS   0xa1b23c4d      // nanosecond timestamps
+#define PCAP_HEADER_LENGTH 24
+#define PCAP_RECORD_LENGTH 16
+#define PCAPNG_SHB      0x0a0d0d0a      // section header block
+#define PCAPNG_IDB      1               // interface description block
+#define PCAPNG_SPB      3               // simple packet block
+#define PCAPNG_EPB      6               // enhanced packet block
+#define PCAPNG_BOM      0x1a2b3c4d      // byte order magic
+#define PCAP_BATCH      4096            // packets parsed by one thread at once
+#define LINKTYPE_NULL       0
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_IPV4       228
+#define LINKTYPE_IPV6       229
+#define LINKTYPE_LINUX_SLL2 276
+#define ETHERTYPE_IPV4  0x0800
+#define ETHERTYPE_IPV6  0x86DD
+#define ETHERTYPE_VLAN  0x8100
+#define ETHERTYPE_QINQ  0x88A8
 
 // class for parsing arguments and storing to config
 class Configuration{
@@ -26,17 +79,27 @@ public:
     bool recursion;
     bool inverse;
     bool aaaa;
+    bool transfer;
     char* server;
     int port;
     char* address;
+    char* bulkFile;
+    int qps;
+    char* pcapFile;
+    int threads;
 
     Configuration(){
         recursion = false;
         inverse = false;
         aaaa = false;
+        transfer = false;
         server = nullptr;
         port = 53;  // default port for DNS
         address = nullptr;
+        bulkFile = nullptr;
+        qps = 0;    // no hard limit of queries per second
+        pcapFile = nullptr;
+        threads = 0;    // one per CPU
     }
 
     /**
@@ -58,6 +121,8 @@ public:
                 inverse = true;
             } else if (!strcmp(argv[i], "-6")){
                 aaaa = true;
+            } else if (!strcmp(argv[i], "-z")){
+                transfer = true;
             } else if (!strcmp(argv[i], "-s")){
 
                 if (++i < argc){
@@ -79,6 +144,50 @@ public:
                     return false;
                 }
 
+            } else if (!strcmp(argv[i], "-b")){
+
+                if (++i < argc){
+                    bulkFile = argv[i];
+                } else {
+                    std::cerr << "Missing value of -b argument!" << std::endl;
+                    return false;
+                }
+
+            } else if (!strcmp(argv[i], "-q")){
+
+                if (++i < argc){
+                    qps = atoi(argv[i]);
+                    if (qps < 1){
+                        std::cerr << "Invalid number of queries per second!" << std::endl;
+                        return false;
+                    }
+                } else {
+                    std::cerr << "Missing value of -q argument!" << std::endl;
+                    return false;
+                }
+
+            } else if (!strcmp(argv[i], "-f")){
+
+                if (++i < argc){
+                    pcapFile = argv[i];
+                } else {
+                    std::cerr << "Missing value of -f argument!" << std::endl;
+                    return false;
+                }
+
+            } else if (!strcmp(argv[i], "-j")){
+
+                if (++i < argc){
+                    threads = atoi(argv[i]);
+                    if (threads < 1){
+                        std::cerr << "Invalid number of threads!" << std::endl;
+                        return false;
+                    }
+                } else {
+                    std::cerr << "Missing value of -j argument!" << std::endl;
+                    return false;
+                }
+
             } else if (address == nullptr) {
                 address = argv[i];
             } else {
@@ -87,7 +196,7 @@ public:
             }
         }
 
-        if (server == nullptr || address == nullptr){ // required args
+        if (pcapFile == nullptr && (server == nullptr || (address == nullptr && bulkFile == nullptr))){ // required args
             std::cerr << "Missing server or question address!"  << std::endl;
             return false;
         }
@@ -105,6 +214,69 @@ struct DNSHeader {
     uint16_t ARCount;       // Number of Additional Resource Records
 };
 
+// names decoded in current message, table is indexed directly by offset of their first label
+class NameMemo{
+public:
+    struct Entry {
+        uint32_t message;       // entry is valid only for message with this number
+        uint32_t position;      // name in arena
+        uint32_t len;
+    };
+
+    std::vector<Entry> entries;     // one per byte of message
+    std::string arena;              // every decoded name stored once
+    uint32_t message;               // number of current message
+
+    NameMemo(){
+        message = 0;
+    }
+
+    /**
+     * Forgets names of previous message, keeps allocated memory
+     * @param messageLen length of next message
+     */
+    void Clear(int messageLen){
+        message++;
+        arena.clear();
+        if ((int) entries.size() < messageLen){
+            entries.resize(messageLen, Entry{0, 0, 0});
+        }
+    }
+
+    /**
+     * Finds name decoded from offset
+     * @param offset offset of first label in message
+     * @param len destination of name length
+     * @return decoded name, nullptr if offset was not decoded yet
+     */
+    const char *Find(int offset, size_t *len) const{
+        if (offset >= (int) entries.size() || entries[offset].message != message){
+            return nullptr;
+        }
+        *len = entries[offset].len;
+        return &arena[entries[offset].position];
+    }
+
+    /**
+     * Remembers decoded name and its suffixes
+     * @param name decoded name
+     * @param len length of the name
+     * @param offsets offsets of labels the name was decoded from
+     * @param offsetsDst position of every label in name
+     * @param count number of labels
+     */
+    void Add(const char *name, int len, const int *offsets, const int *offsetsDst, int count){
+        uint32_t position = (uint32_t) arena.size();
+        arena.append(name, len);
+        for (int i = 0; i < count; ++i) {
+            int offset = offsets[i];
+            if (offset < (int) entries.size()){
+                entries[offset] = Entry{message, position + offsetsDst[i], (uint32_t) (len - offsetsDst[i])};
+            }
+        }
+    }
+};
+
 class Resolver{
 public:
     enum QType : int {
@@ -146,16 +318,23 @@ public:
     uint8_t *answer;
     int answerLen;
     char ip[16]{};
+    std::ostream *out;  // destination of printed answer
+    bool csv;           // print records as csv lines
+    size_t packet;      // number of packet in csv output
+    NameMemo names;     // decoded names of current message
 
     Resolver(){
         queryLen = 0;
         answer = nullptr;
         answerLen = 0;
         memset(ip, 0 ,sizeof(ip));
+        out = &std::cout;
+        csv = false;
+        packet = 0;
     }
 
     ~Resolver(){
-        delete answer;
+        delete[] answer;
     }
 
     void Configure(Configuration conf){
@@ -194,8 +373,8 @@ public:
             position = EncodeLabel(config.address, query);
         }
 
-        // query type PTR, AAAA or A record type
-        uint16_t queryType = htons(config.inverse ? QType::PTR : (config.aaaa ? QType::AAAA : QType::A));
+        // query type XFR, PTR, AAAA or A record type
+        uint16_t queryType = htons(config.transfer ? QType::XFR : (config.inverse ? QType::PTR : (config.aaaa ? QType::AAAA : QType::A)));
         memcpy(&query[position], &queryType, sizeof(queryType));
         position += sizeof(queryType);
 
@@ -207,16 +386,23 @@ public:
     }
 
     /**
-     * Sends DNS packet via UDP
+     * Combines header and question into one message
+     * @param msg destination of the message, at least sizeof(header) + queryLen bytes
+     * @return length of the message
      */
-    void SendQuestion(){
-        // combining header and question
-        uint8_t msg[sizeof(header) + queryLen];
+    int BuildMessage(uint8_t *msg){
         memcpy(msg, &header, sizeof(header));
         memcpy(&msg[sizeof(header)], query, queryLen);
+        return (int) sizeof(header) + queryLen;
+    }
 
+    /**
+     * Creates socket connected to the configured server
+     * @param type SOCK_DGRAM or SOCK_STREAM
+     * @return socket descriptor
+     */
+    int ConnectSocket(int type){
         int sock;                           // socket descriptor
-        int i;
         sockaddr_in server{};                 // ipv4 address structures of the server and the client
         sockaddr_in6 serverV6{};              // ipv6 address structures of the server and the client
 
@@ -242,16 +428,9 @@ public:
             exit(EXIT_FAILURE);
         }
 
-        if (ipv6){
-            if ((sock = socket(AF_INET6 , SOCK_DGRAM , 0)) == -1){  //create a client socket
-                std::cerr << "Failed creating socket!" << std::endl;
-                exit(EXIT_FAILURE);
-            }
-        } else {
-            if ((sock = socket(AF_INET , SOCK_DGRAM , 0)) == -1){  //create a client socket
-                std::cerr << "Failed creating socket!" << std::endl;
-                exit(EXIT_FAILURE);
-            }
+        if ((sock = socket(ipv6 ? AF_INET6 : AF_INET, type, 0)) == -1){  //create a client socket
+            std::cerr << "Failed creating socket!" << std::endl;
+            exit(EXIT_FAILURE);
         }
 
         if (ipv6){
@@ -266,6 +445,19 @@ public:
             }
         }
 
+        return sock;
+    }
+
+    /**
+     * Sends DNS packet via UDP
+     */
+    void SendQuestion(){
+        uint8_t msg[sizeof(header) + queryLen];
+        BuildMessage(msg);
+
+        int i;
+        int sock = ConnectSocket(SOCK_DGRAM);
+
         i = (int) send(sock,msg, sizeof(msg),0);
         if (i == -1){
             std::cerr << "Failed sending the packet!" << std::endl;
@@ -294,133 +486,176 @@ public:
         }
         answer = new uint8_t[answerLen];
         memcpy(answer, buffer, answerLen);
+        close(sock);
     }
 
     /**
-     * Decodes answer and writes it to std::cout if print is true
+     * Decodes answer and writes it to out if print is true
      * @param print bool deciding if answer should be printed
+     * @return False on malformed answer
      */
-    void ParseAnswer(bool print){
+    bool ParseAnswer(bool print){
+        if (answerLen < (int) sizeof(header)){
+            return false;
+        }
+
         DNSHeader answerHeader = DNSHeader();
-        uint8_t answerBody[answerLen - sizeof(header)];
+        const uint8_t *answerBody = &answer[sizeof(header)];
+        int bodyLen = answerLen - (int) sizeof(header);
         int position = 0;
         char buffer[MSG_LENGTH];
         uint16_t tmp = 0;
+        bool printSections = print && !csv;     // csv holds records only
 
         memcpy(&answerHeader, answer, sizeof(header));
-        memcpy(answerBody, &answer[sizeof(header)], sizeof(answerBody));
+        names.Clear(answerLen);
 
         // print header
-        if (print){
-            std::cout << "Authoritative: " << (ntohs(answerHeader.Flags) & AABIT ? "Yes" : "No") << ", "
+        if (printSections){
+            *out << "Authoritative: " << (ntohs(answerHeader.Flags) & AABIT ? "Yes" : "No") << ", "
             << "Recursive: " << (ntohs(answerHeader.Flags) & RECURSIONBIT ? "Yes" : "No") << ", "
             << "Truncated: " << (ntohs(answerHeader.Flags) & TRUNCATIONBIT ? "Yes" : "No") << std::endl;
         }
 
         // print question section
         uint16_t questionCount = ntohs(answerHeader.QDCount);
-        if (print){
-            std::cout << "Question section (" << questionCount << ")" << std::endl;
+        if (printSections){
+            *out << "Question section (" << questionCount << ")" << std::endl;
         }
         for (int i = 0; i < questionCount; ++i) {
-            position += DecodeLabel(answerBody, buffer, answer);     // question
-            if (print){
-                std::cout << "\t" << buffer << ", ";
+            int used = DecodeLabel(&answerBody[position], buffer, answer, answerLen, &names);     // question
+            if (used < 0 || position + used + 2 * (int) sizeof(uint16_t) > bodyLen){
+                return false;
+            }
+            position += used;
+            if (printSections){
+                *out << "\t" << buffer << ", ";
             }
 
             memcpy(&tmp, &answerBody[position], sizeof(uint16_t));
-            if (print){
-                printQType(static_cast<QType>(ntohs(tmp)));                 // QTYPE
+            if (printSections){
+                printQType(static_cast<QType>(ntohs(tmp)), *out);                 // QTYPE
             }
             position += sizeof(uint16_t);
 
-            if (print){
-                std::cout << ", ";
+            if (printSections){
+                *out << ", ";
             }
 
             memcpy(&tmp, &answerBody[position], sizeof(uint16_t));
-            if (print){
-                printQClass(static_cast<QClass>(ntohs(tmp)));             // QCLASS
+            if (printSections){
+                printQClass(static_cast<QClass>(ntohs(tmp)), *out);             // QCLASS
             }
             position += sizeof(uint16_t);
 
-            if (print){
-                std::cout << std::endl;
+            if (printSections){
+                *out << std::endl;
             }
         }
 
         // print answer section
         uint16_t answerCount = ntohs(answerHeader.ANCount);
-        if (print){
-            std::cout << "Answer section (" << answerCount << ")" << std::endl;
+        if (printSections){
+            *out << "Answer section (" << answerCount << ")" << std::endl;
+        }
+        if (!parseRR(answerBody, &position, buffer, answerCount, print, "answer")){
+            return false;
         }
-        parseRR(answerBody, &position, buffer, answerCount, print);
 
         // print authority section
         uint16_t authorityCount = ntohs(answerHeader.NSCount);
-        if (print){
-            std::cout << "Authority section (" << authorityCount << ")" << std::endl;
+        if (printSections){
+            *out << "Authority section (" << authorityCount << ")" << std::endl;
+        }
+        if (!parseRR(answerBody, &position, buffer, authorityCount, print, "authority")){
+            return false;
         }
-        parseRR(answerBody, &position, buffer, authorityCount, print);
 
         // print additional section
         uint16_t additionalCount = ntohs(answerHeader.ARCount);
-        if (print){
-            std::cout << "Additional section (" << additionalCount << ")" << std::endl;
+        if (printSections){
+            *out << "Additional section (" << additionalCount << ")" << std::endl;
         }
-        parseRR(answerBody, &position, buffer, additionalCount, print);
+        return parseRR(answerBody, &position, buffer, additionalCount, print, "additional");
     }
 
     /**
      * Decodes records and prints them if print is true
-     * @param answerBody array to be decoded
+     * @param answerBody array to be decoded, part of answer
      * @param position position of next RR
      * @param buffer destination of decoded line
      * @param rrCount how many RRs is in answerBody
      * @param print bool deciding if answer should be printed
+     * @param section name of the section for csv output
+     * @return False on malformed record
      */
-    void parseRR(const uint8_t *answerBody, int *position, char *buffer, uint16_t rrCount, bool print){
+    bool parseRR(const uint8_t *answerBody, int *position, char *buffer, uint16_t rrCount, bool print, const char *section){
+        int bodyLen = answerLen - (int) sizeof(DNSHeader);
+        const char *separator = csv ? "," : ", ";
+        char hex[4];
         uint16_t tmp = 0;
         for (int i = 0; i < rrCount; ++i) {
-            *position += DecodeLabel(&answerBody[*position], buffer, answer);
+            int used = DecodeLabel(&answerBody[*position], buffer, answer, answerLen, &names);
+            if (used < 0 || *position + used + 10 > bodyLen){                     // TYPE, CLASS, TTL, RDLENGTH
+                return false;
+            }
+            *position += used;
             if (print){
-                std::cout << "\t" << buffer << ", ";                                            // NAME
+                if (csv){
+                    *out << packet << "," << section << ",";
+                } else {
+                    *out << "\t";
+                }
+                if (csv){
+                    *out << '"';
+                }
+                PrintName(buffer);                                                      // NAME
+                *out << (csv ? "\"" : "") << separator;
             }
 
             memcpy(&tmp, &answerBody[*position], sizeof(uint16_t));
             auto qtype = static_cast<QType>(ntohs(tmp));
             if (print){
-                printQType(qtype);                                                 // QTYPE
+                printQType(qtype, *out, csv);                                            // QTYPE
             }
             *position += sizeof(uint16_t);
 
             if (print){
-                std::cout << ", ";
+                *out << separator;
             }
 
             memcpy(&tmp, &answerBody[*position], sizeof(uint16_t));
             if (print){
-                printQClass(static_cast<QClass>(ntohs(tmp)));            // QCLASS
+                printQClass(static_cast<QClass>(ntohs(tmp)), *out, csv);       // QCLASS
             }
             *position += sizeof(uint16_t);
 
             if (print){
-                std::cout << ", ";
+                *out << separator;
             }
 
             uint32_t ttl = 0;
             memcpy(&ttl, &answerBody[*position], sizeof(uint32_t));
             if (print){
-                std::cout << ntohl(ttl) << ", ";                                // TTL
+                *out << ntohl(ttl) << separator << (csv ? "\"" : "");           // TTL, data is quoted in csv
             }
             *position += sizeof(uint32_t);
 
-            *position += sizeof(uint16_t);                                          // skipping RDLENGTH
+            memcpy(&tmp, &answerBody[*position], sizeof(uint16_t));             // RDLENGTH
+            *position += sizeof(uint16_t);
+            int rdataEnd = *position + ntohs(tmp);
+            if (rdataEnd > bodyLen){
+                return false;
+            }
+
             switch (qtype) {
                 case A:
+                    if (rdataEnd - *position != 4){
+                        return false;
+                    }
                     for (int j = 0, k = 0; j < 4; ++j) {
                         if (print){
-                            std::cout << (int) answerBody[*position] << (j < 3 ? "." : "");
+                            *out << (int) answerBody[*position] << (j < 3 ? "." : "");
                         }
                         k += snprintf(&ip[k], 4, "%d", (int) answerBody[*position]);
                         if (j < 3){
@@ -432,40 +667,225 @@ public:
                 case CNAME:
                 case NS:
                 case PTR:
-                    *position += DecodeLabel(&answerBody[*position], buffer, answer);
+                    used = DecodeLabel(&answerBody[*position], buffer, answer, answerLen, &names);
+                    if (used < 0){
+                        return false;
+                    }
+                    if (print){
+                        PrintName(buffer);
+                    }
+                    break;
+                case SOA:
+                    used = DecodeLabel(&answerBody[*position], buffer, answer, answerLen, &names);     // MNAME
+                    if (used < 0){
+                        return false;
+                    }
+                    *position += used;
+                    if (print){
+                        PrintName(buffer);
+                        *out << " ";
+                    }
+                    used = DecodeLabel(&answerBody[*position], buffer, answer, answerLen, &names);     // RNAME
+                    if (used < 0 || *position + used + 5 * (int) sizeof(uint32_t) > rdataEnd){
+                        return false;
+                    }
+                    *position += used;
                     if (print){
-                        std::cout << buffer;
+                        PrintName(buffer);
+                    }
+                    for (int j = 0; j < 5; ++j) {                                       // SERIAL, REFRESH, RETRY, EXPIRE, MINIMUM
+                        uint32_t value = 0;
+                        memcpy(&value, &answerBody[*position], sizeof(uint32_t));
+                        if (print){
+                            *out << " " << ntohl(value);
+                        }
+                        *position += sizeof(uint32_t);
                     }
                     break;
                 case AAAA:
+                    if (rdataEnd - *position != 16){
+                        return false;
+                    }
                     for (int j = 0; j < 16; j++) {
                         if (print){
-                            printf("%02X", answerBody[*position]);
+                            snprintf(hex, sizeof(hex), "%02X", answerBody[*position]);
+                            *out << hex;
                             if (j % 2 == 1 && j < 14){
-                                std::cout << ":";
+                                *out << ":";
                             }
                         }
                         (*position)++;
                     }
                     break;
                 default:
-                    if (print){
-                        std::cout << "Not implemented, data: ";
+                    if (print && !csv){
+                        *out << "Not implemented, data: ";
                     }
-                    memcpy(&tmp, &answerBody[*position - 2], sizeof(uint16_t));
-                    for (int j = 0; j < ((int) ntohs(tmp)); j++) {
+                    for (int j = 0; *position < rdataEnd; j++, (*position)++) {
                         if (print){
-                            printf("%02X ", answerBody[*position]);
+                            snprintf(hex, sizeof(hex), "%02X", answerBody[*position]);
+                            *out << (j ? " " : "") << hex;
                         }
-                        (*position)++;
                     }
                     break;
             }
+            *position = rdataEnd;
 
             if (print){
-                std::cout << std::endl;
+                *out << (csv ? "\"" : "") << '\n';                               // flushed by caller
             }
         }
+        return true;
+    }
+
+    /**
+     * Requests zone transfer via TCP and prints records of every message as it arrives,
+     * only one message is held in memory at a time
+     */
+    void TransferZone(){
+        uint8_t msg[sizeof(uint16_t) + sizeof(header) + queryLen];
+        uint16_t msgLen = htons(BuildMessage(&msg[sizeof(uint16_t)]));
+        memcpy(msg, &msgLen, sizeof(uint16_t));    // TCP messages are prefixed by length
+
+        int sock = ConnectSocket(SOCK_STREAM);
+        if (!SendAll(sock, msg, sizeof(msg))){
+            std::cerr << "Failed sending the packet!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // setting timeout to 5 seconds
+        struct timeval timeout{};
+        timeout.tv_sec = 5;
+        timeout.tv_usec = 0;
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) == -1) {
+            std::cerr << "Error setting receive timeout!";
+        }
+
+        answer = new uint8_t[TCP_MSG_LENGTH];
+        char buffer[MSG_LENGTH];
+        int messages = 0;
+        int records = 0;
+        int soaCount = 0;
+        uint32_t serial = 0;
+
+        std::cout << "Zone transfer (" << config.address << ")" << std::endl;
+
+        // transfer ends with the same SOA record it started with
+        while (soaCount < 2){
+            if (!RecvAll(sock, (uint8_t *) &msgLen, sizeof(uint16_t))){
+                std::cerr << "Zone transfer ended unexpectedly!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            answerLen = ntohs(msgLen);
+            if (answerLen < (int) sizeof(header) || !RecvAll(sock, answer, answerLen)){
+                std::cerr << "Zone transfer ended unexpectedly!" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            messages++;
+            names.Clear(answerLen);
+
+            DNSHeader answerHeader = DNSHeader();
+            memcpy(&answerHeader, answer, sizeof(header));
+            if (ntohs(answerHeader.Flags) & RCODEMASK){
+                std::cerr << "Zone transfer refused, rcode: " << (ntohs(answerHeader.Flags) & RCODEMASK) << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            // skipping question section, names are decoded against the whole message
+            const uint8_t *answerBody = &answer[sizeof(header)];
+            int position = 0;
+            for (int i = 0; i < ntohs(answerHeader.QDCount); ++i) {
+                int used = DecodeLabel(&answerBody[position], buffer, answer, answerLen, &names);
+                if (used < 0){
+                    std::cerr << "Malformed zone transfer message!" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                position += used + 2 * (int) sizeof(uint16_t);                     // QTYPE, QCLASS
+            }
+
+            uint16_t answerCount = ntohs(answerHeader.ANCount);
+            for (int i = 0; i < answerCount && soaCount < 2; ++i) {
+                // type is checked before the record is printed
+                uint16_t type;
+                int rdata = SkipLabel(&answerBody[position], answer, answerLen);
+                if (rdata < 0 || position + rdata + 10 > answerLen - (int) sizeof(header)){  // TYPE, CLASS, TTL, RDLENGTH
+                    std::cerr << "Malformed zone transfer message!" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                rdata += position;
+                memcpy(&type, &answerBody[rdata], sizeof(uint16_t));
+                rdata += 10;
+                if (ntohs(type) != QType::SOA && soaCount == 0){
+                    std::cerr << "Zone transfer does not start with SOA record!" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+
+                if (!parseRR(answerBody, &position, buffer, 1, true, "answer")){
+                    std::cerr << "Malformed zone transfer message!" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                records++;
+                if (ntohs(type) != QType::SOA){
+                    continue;
+                }
+
+                // SOA record is already validated by parseRR
+                rdata += SkipLabel(&answerBody[rdata], answer, answerLen);         // MNAME
+                rdata += SkipLabel(&answerBody[rdata], answer, answerLen);         // RNAME
+                uint32_t recordSerial;
+                memcpy(&recordSerial, &answerBody[rdata], sizeof(uint32_t));
+                if (soaCount == 0){
+                    serial = recordSerial;
+                } else if (recordSerial != serial){
+                    std::cerr << "Zone changed during transfer, SOA serial " << ntohl(recordSerial)
+                    << " does not match " << ntohl(serial) << "!" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                soaCount++;
+            }
+            std::cout.flush();                                                      // once per message
+        }
+        close(sock);
+
+        std::cout << "Records: " << records << ", Messages: " << messages << std::endl;
+    }
+
+    /**
+     * Sends whole buffer to stream socket
+     * @param sock socket descriptor
+     * @param src data to be sent
+     * @param len length of data
+     * @return True on success
+     */
+    static bool SendAll(int sock, const uint8_t *src, int len){
+        while (len > 0){
+            int i = (int) send(sock, src, len, 0);
+            if (i <= 0){
+                return false;
+            }
+            src += i;
+            len -= i;
+        }
+        return true;
+    }
+
+    /**
+     * Receives exactly len bytes from stream socket
+     * @param sock socket descriptor
+     * @param dst destination of received data
+     * @param len number of bytes to be received
+     * @return True on success
+     */
+    static bool RecvAll(int sock, uint8_t *dst, int len){
+        while (len > 0){
+            int i = (int) recv(sock, dst, len, 0);
+            if (i <= 0){
+                return false;
+            }
+            dst += i;
+            len -= i;
+        }
+        return true;
     }
 
     /**
@@ -544,152 +964,898 @@ public:
         return position;
     }
 
+    /**
+     * Finds length of encoded name without decoding it
+     * @param src labels to be skipped, must point into wholeSrc
+     * @param wholeSrc complete message
+     * @param wholeLen length of complete message
+     * @return number of used bytes from src, -1 on malformed name
+     */
+    static int SkipLabel(const uint8_t *src, const uint8_t *wholeSrc, int wholeLen){
+        int start = (int) (src - wholeSrc);
+        int position = start;
+        while (position < wholeLen){
+            if ((wholeSrc[position] & LABELPOINER) == LABELPOINER){
+                return position + (int) sizeof(uint16_t) - start;
+            }
+            if (wholeSrc[position] == 0){
+                return position + 1 - start;
+            }
+            position += wholeSrc[position] + 1;
+        }
+        return -1;
+    }
+
     /**
      * Decodes sequence of labels into readable string
-     * @param src labels to be decoded
-     * @param dst destination of final string
-     * @param wholeSrc complete query
-     * @return number of used bytes from src
+     * @param src labels to be decoded, must point into wholeSrc
+     * @param dst destination of final string, at least MSG_LENGTH bytes
+     * @param wholeSrc complete message
+     * @param wholeLen length of complete message
+     * @param memo names already decoded in this message, pointers to them are not followed again
+     * @return number of used bytes from src, -1 on malformed name
      */
-    static int DecodeLabel(const uint8_t *src, char *dst, const uint8_t *wholeSrc){
-        int positionSrc = 0;
+    static int DecodeLabel(const uint8_t *src, char *dst, const uint8_t *wholeSrc, int wholeLen, NameMemo *memo = nullptr){
+        int start = (int) (src - wholeSrc);
+        int positionSrc = start;        // offset in wholeSrc
         int positionDst = 0;
         int returnedPosition = 0;
-        bool jumped = false;
-
-        while (src[positionSrc] != 0){
-            if (src[positionSrc] & LABELPOINER){
+        int jumps = 0;
+        bool memoized = false;
+
+        // labels of this name, remembered for following names
+        int offsets[LABEL_LIMIT];
+        int offsetsDst[LABEL_LIMIT];
+        int offsetCount = 0;
+
+        while (positionSrc < wholeLen && wholeSrc[positionSrc] != 0){
+            if ((wholeSrc[positionSrc] & LABELPOINER) == LABELPOINER){
+                if (positionSrc + 1 >= wholeLen || ++jumps > POINTER_LIMIT){      // pointer loop
+                    return -1;
+                }
                 uint16_t tmp;
-                memcpy(&tmp, &src[positionSrc], sizeof(uint16_t));
-                src = wholeSrc;
-                if (!jumped){
+                memcpy(&tmp, &wholeSrc[positionSrc], sizeof(uint16_t));
+                if (jumps == 1){
                     returnedPosition = positionSrc + (int) sizeof(uint16_t);
                 }
-                jumped = true;
                 positionSrc = ntohs(tmp) - 0xC000;
-            }
-
-            int charCount = src[positionSrc];
-            for (int i = 0; i < charCount; i++) {
-                positionSrc++;
 
-                dst[positionDst] = (char) src[positionSrc];
-                positionDst++;
+                if (memo != nullptr){
+                    size_t len;
+                    const char *found = memo->Find(positionSrc, &len);
+                    if (found != nullptr){
+                        if (positionDst + (int) len >= MSG_LENGTH){
+                            return -1;
+                        }
+                        memcpy(&dst[positionDst], found, len);
+                        positionDst += (int) len;
+                        memoized = true;
+                        break;
+                    }
+                }
+                continue;
+            }
+            if (wholeSrc[positionSrc] & LABELPOINER){                               // reserved label types
+                return -1;
             }
 
-            positionSrc++;
+            int charCount = wholeSrc[positionSrc];
+            if (positionSrc + charCount >= wholeLen || positionDst + 4 * charCount + 1 >= MSG_LENGTH){   // \DDD escapes
+                return -1;
+            }
+            if (memo != nullptr && offsetCount < LABEL_LIMIT){
+                offsets[offsetCount] = positionSrc;
+                offsetsDst[offsetCount++] = positionDst;
+            }
+            // label is escaped as in presentation format so dots inside of it stay distinguishable
+            for (int i = 1; i <= charCount; ++i) {
+                uint8_t c = wholeSrc[positionSrc + i];
+                if (c == '.' || c == '\\'){
+                    dst[positionDst++] = '\\';
+                    dst[positionDst++] = (char) c;
+                } else if (c < '!' || c > '~'){
+                    positionDst += snprintf(&dst[positionDst], 5, "\\%03d", c);
+                } else {
+                    dst[positionDst++] = (char) c;
+                }
+            }
+            positionSrc += charCount + 1;
             dst[positionDst] = '.';
             positionDst++;
-
         }
 
+        if (!memoized && positionSrc >= wholeLen){
+            return -1;
+        }
         positionSrc++;
         dst[positionDst] = 0;
 
-        if (jumped){
-            return returnedPosition;
+        if (memo != nullptr && offsetCount){
+            memo->Add(dst, positionDst, offsets, offsetsDst, offsetCount);
+        }
+
+        if (jumps){
+            return returnedPosition - start;
+        }
+        return positionSrc - start;
+    }
+
+    /**
+     * Prints decoded name to out, in csv the field is quoted so quotes inside of it are doubled (RFC 4180)
+     * @param name decoded name
+     */
+    void PrintName(const char *name){
+        if (!csv){
+            *out << name;
+            return;
+        }
+
+        for (; *name; name++) {
+            if (*name == '"'){
+                *out << '"';
+            }
+            *out << *name;
         }
-        return positionSrc;
     }
 
     /**
-     * Prints string representation of QType to std::cout
+     * Prints string representation of QType to out
      * @param type
+     * @param out destination stream
+     * @param numeric print unknown type as its number (TYPE41)
      */
-    static void printQType(QType type) {
+    static void printQType(QType type, std::ostream &out, bool numeric = false) {
         switch (type) {
             case QType::A:
-                std::cout << "A";
+                out << "A";
                 break;
             case QType::NS:
-                std::cout << "NS";
+                out << "NS";
                 break;
             case QType::MD:
-                std::cout << "MD";
+                out << "MD";
                 break;
             case QType::MF:
-                std::cout << "MF";
+                out << "MF";
                 break;
             case QType::CNAME:
-                std::cout << "CNAME";
+                out << "CNAME";
                 break;
             case QType::SOA:
-                std::cout << "SOA";
+                out << "SOA";
                 break;
             case QType::MB:
-                std::cout << "MB";
+                out << "MB";
                 break;
             case QType::MG:
-                std::cout << "MG";
+                out << "MG";
                 break;
             case QType::MR:
-                std::cout << "MR";
+                out << "MR";
                 break;
             case QType::NULL_RR:
-                std::cout << "NULL";
+                out << "NULL";
                 break;
             case QType::WKS:
-                std::cout << "WKS";
+                out << "WKS";
                 break;
             case QType::PTR:
-                std::cout << "PTR";
+                out << "PTR";
                 break;
             case QType::HINFO:
-                std::cout << "HINFO";
+                out << "HINFO";
                 break;
             case QType::MINFO:
-                std::cout << "MINFO";
+                out << "MINFO";
                 break;
             case QType::MX:
-                std::cout << "MX";
+                out << "MX";
                 break;
             case QType::TXT:
-                std::cout << "TXT";
+                out << "TXT";
                 break;
             case QType::AAAA:
-                std::cout << "AAAA";
+                out << "AAAA";
                 break;
             case QType::XFR:
-                std::cout << "XFR";
+                out << "XFR";
                 break;
             case QType::MAILB:
-                std::cout << " MAILB";
+                out << " MAILB";
                 break;
             case QType::MAILA:
-                std::cout << "MAILA";
+                out << "MAILA";
                 break;
             case QType::ALL:
-                std::cout << "*";
+                out << "*";
                 break;
             default:
-                std::cout << "Unknown DNS type";
+                if (numeric){
+                    out << "TYPE" << (int) type;
+                } else {
+                    out << "Unknown DNS type";
+                }
         }
     }
 
     /**
-     * Prints string representation of QClass to std::cout
+     * Prints string representation of QClass to out
      * @param qClass
+     * @param out destination stream
+     * @param numeric print unknown class as its number (CLASS1232)
      */
-    static void printQClass(QClass qClass) {
+    static void printQClass(QClass qClass, std::ostream &out, bool numeric = false) {
         switch (qClass) {
             case QClass::IN:
-                std::cout << "IN";
+                out << "IN";
                 break;
             case QClass::CS:
-                std::cout << "CS";
+                out << "CS";
                 break;
             case QClass::CH:
-                std::cout << "CH";
+                out << "CH";
                 break;
             case QClass::HS:
-                std::cout << "HS";
+                out << "HS";
                 break;
             case QClass::ANY:
-                std::cout << "*";
+                out << "*";
+                break;
+            default:
+                if (numeric){
+                    out << "CLASS" << (int) qClass;
+                } else {
+                    out << "Unknown DNS class";
+                }
+        }
+    }
+};
+
+// paces bulk queries: token bucket caps QPS, AIMD window adapts to the health of the upstream
+class Pacer{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    double rate;        // hard cap of queries per second, 0 = unlimited
+    double burst;       // token bucket capacity, never above rate
+    double tokens;
+    double window;      // queries allowed in flight
+    double threshold;   // slow start threshold
+    double minRtt;      // lowest RTT observed in last PACER_MIN_RTT_WINDOW_MS (ms)
+    double srtt;        // smoothed RTT (ms)
+    double rttvar;      // RTT variation (ms)
+    Clock::time_point minRttTime;
+    Clock::time_point lastRefill;
+    Clock::time_point lastDecrease;     // queries sent before it do not shrink the window again
+
+    explicit Pacer(int qps){
+        rate = qps;
+        burst = rate > 0 ? std::min(rate, (double) PACER_BURST) : PACER_BURST;
+        tokens = burst;
+        window = PACER_INIT_WINDOW;
+        threshold = PACER_MAX_WINDOW;
+        minRtt = 0;
+        srtt = 0;
+        rttvar = 0;
+        lastRefill = Clock::now();
+        lastDecrease = lastRefill;
+        minRttTime = lastRefill;
+    }
+
+    /**
+     * Refills token bucket and decides if another query may be sent
+     * @param inFlight number of queries waiting for answer
+     * @return True if query can be sent now
+     */
+    bool CanSend(size_t inFlight){
+        if (inFlight >= (size_t) window){
+            return false;
+        }
+        if (rate <= 0){
+            return true;
+        }
+
+        Clock::time_point now = Clock::now();
+        tokens += std::chrono::duration<double>(now - lastRefill).count() * rate;
+        tokens = std::min(tokens, burst);
+        lastRefill = now;
+        return tokens >= 1;
+    }
+
+    /**
+     * Takes token for sent query
+     */
+    void OnSent(){
+        if (rate > 0){
+            tokens -= 1;
+        }
+    }
+
+    /**
+     * Retransmission timeout derived from RTT as in RFC 6298
+     * @return timeout (ms)
+     */
+    double Timeout() const{
+        if (srtt == 0){
+            return BULK_TIMEOUT_MS;
+        }
+        return std::min(std::max(srtt + 4 * rttvar, (double) PACER_MIN_TIMEOUT_MS), (double) BULK_TIMEOUT_MS);
+    }
+
+    /**
+     * Grows the window on healthy answer, shrinks it on error rcode or inflated RTT
+     * @param sent time when the query was sent
+     * @param rcode response code of the answer
+     * @param inFlight number of queries waiting for answer, including this one
+     */
+    void OnAnswer(Clock::time_point sent, int rcode, size_t inFlight){
+        Clock::time_point now = Clock::now();
+        double rtt = std::chrono::duration<double, std::milli>(now - sent).count();
+        if (minRtt == 0 || rtt < minRtt
+            || std::chrono::duration<double, std::milli>(now - minRttTime).count() > PACER_MIN_RTT_WINDOW_MS){
+            minRtt = rtt;
+            minRttTime = now;
+        }
+        if (srtt == 0){
+            srtt = rtt;
+            rttvar = rtt / 2;
+        } else {
+            rttvar = 0.75 * rttvar + 0.25 * std::abs(srtt - rtt);
+            srtt = 0.875 * srtt + 0.125 * rtt;
+        }
+
+        if (rcode == RCODE_SERVFAIL || rcode == RCODE_REFUSED
+            || (srtt > minRtt * PACER_RTT_INFLATION && srtt > minRtt + PACER_RTT_SLACK_MS)){
+            OnLoss(sent);
+            return;
+        }
+
+        // window not used by sender (token bucket is the limit) does not grow, RFC 7661
+        if (inFlight * 2 < window){
+            return;
+        }
+
+        if (window < threshold){
+            window += 1;                // slow start
+        } else {
+            window += 1 / window;       // additive increase, one query per RTT
+        }
+        window = std::min(window, (double) PACER_MAX_WINDOW);
+    }
+
+    /**
+     * Halves the window, only once for queries sent within the same window so one burst of losses counts once
+     * @param sent time when the lost query was sent
+     */
+    void OnLoss(Clock::time_point sent){
+        if (sent < lastDecrease){
+            return;
+        }
+        lastDecrease = Clock::now();
+        window = std::max(window / 2, 1.0);
+        threshold = window;
+    }
+};
+
+// sends queries for every name from file, paced by Pacer
+class BulkResolver{
+public:
+    struct Query {
+        size_t index;                               // index of name in names
+        int attempts;                               // resends so far
+        Pacer::Clock::time_point sent;
+    };
+
+    Configuration config;
+    std::vector<std::string> names;
+    Pacer pacer;
+
+    explicit BulkResolver(Configuration conf) : config(conf), pacer(conf.qps) {}
+
+    /**
+     * Loads names to be resolved, one per line
+     * @return True on success
+     */
+    bool LoadNames(){
+        std::ifstream file(config.bulkFile);
+        if (!file){
+            std::cerr << "Failed opening file " << config.bulkFile << "!" << std::endl;
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(file, line)){
+            // trimming whitespace and CR of CRLF files
+            size_t first = line.find_first_not_of(" \t\r");
+            size_t last = line.find_last_not_of(" \t\r");
+            line = first == std::string::npos ? "" : line.substr(first, last - first + 1);
+            if (line.empty()){
+                continue;
+            }
+            if (line.size() > QUERY_LENGTH - 2 * sizeof(uint16_t) - 2){
+                std::cerr << "Skipping too long name: " << line << std::endl;
+                continue;
+            }
+            names.push_back(line);
+        }
+        return true;
+    }
+
+    /**
+     * Sends all queries and prints answers as they arrive,
+     * timed out and refused queries are sent again up to BULK_RETRIES times
+     */
+    void Run(){
+        size_t next = 0;
+        uint16_t nextId = 0;
+        int answered = 0;
+        int errors = 0;
+        int lost = 0;
+        int retries = 0;
+        std::map<uint16_t, Query> inFlight;
+        std::deque<Query> retry;                    // queries waiting to be sent again
+
+        Resolver base = Resolver();
+        base.config = config;
+        int sock = base.ConnectSocket(SOCK_DGRAM);
+        Pacer::Clock::time_point start = Pacer::Clock::now();
+
+        while (next < names.size() || !retry.empty() || !inFlight.empty()){
+            // send as many queries as pacer allows, resends first
+            while ((!retry.empty() || next < names.size()) && pacer.CanSend(inFlight.size())){
+                Query query = Query{next, 0, Pacer::Clock::time_point()};
+                if (!retry.empty()){
+                    query = retry.front();
+                    retry.pop_front();
+                    retries++;
+                } else {
+                    next++;
+                }
+
+                while (inFlight.count(nextId)){
+                    nextId++;
+                }
+
+                Configuration conf = config;
+                conf.address = &names[query.index][0];
+                Resolver resolver = Resolver();
+                resolver.Configure(conf);
+                resolver.header.ID = htons(nextId);
+
+                uint8_t msg[sizeof(DNSHeader) + QUERY_LENGTH];
+                int msgLen = resolver.BuildMessage(msg);
+                if (send(sock, msg, msgLen, 0) == -1){
+                    std::cerr << "Failed sending the packet!" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+
+                query.sent = Pacer::Clock::now();
+                inFlight[nextId++] = query;
+                pacer.OnSent();
+            }
+
+            struct pollfd fd{};
+            fd.fd = sock;
+            fd.events = POLLIN;
+            poll(&fd, 1, BULK_POLL_MS);
+
+            // receiving answers
+            uint8_t buffer[MSG_LENGTH];
+            int len;
+            while ((len = (int) recv(sock, buffer, MSG_LENGTH, MSG_DONTWAIT)) > 0){
+                if (len < (int) sizeof(DNSHeader)){
+                    continue;
+                }
+
+                DNSHeader answerHeader = DNSHeader();
+                memcpy(&answerHeader, buffer, sizeof(answerHeader));
+                auto found = inFlight.find(ntohs(answerHeader.ID));
+                if (found == inFlight.end()){
+                    continue;   // late answer of query which already timed out
+                }
+
+                int rcode = ntohs(answerHeader.Flags) & RCODEMASK;
+                Query query = found->second;
+                pacer.OnAnswer(query.sent, rcode, inFlight.size());
+                inFlight.erase(found);
+
+                if ((rcode == RCODE_REFUSED || rcode == RCODE_SERVFAIL) && query.attempts < BULK_RETRIES){
+                    query.attempts++;
+                    retry.push_back(query);
+                    continue;
+                }
+
+                Resolver resolver = Resolver();
+                resolver.answer = new uint8_t[len];
+                resolver.answerLen = len;
+                memcpy(resolver.answer, buffer, len);
+                if (!resolver.ParseAnswer(true)){
+                    std::cerr << "Malformed answer: " << names[query.index] << std::endl;
+                    errors++;
+                } else if (rcode == 0 || rcode == RCODE_NXDOMAIN){
+                    answered++;
+                } else {
+                    errors++;                   // does not count to goodput
+                }
+            }
+
+            // expiring queries without answer, timeout doubles with every resend
+            Pacer::Clock::time_point now = Pacer::Clock::now();
+            for (auto found = inFlight.begin(); found != inFlight.end();){
+                Query query = found->second;
+                double timeout = std::min(pacer.Timeout() * (1 << query.attempts), (double) BULK_TIMEOUT_MS);
+                if (std::chrono::duration<double, std::milli>(now - query.sent).count() < timeout){
+                    ++found;
+                    continue;
+                }
+                pacer.OnLoss(query.sent);
+                found = inFlight.erase(found);
+
+                if (query.attempts < BULK_RETRIES){
+                    query.attempts++;
+                    retry.push_back(query);
+                } else {
+                    std::cerr << "Receive timeout occurred: " << names[query.index] << std::endl;
+                    lost++;
+                }
+            }
+        }
+        close(sock);
+
+        double elapsed = std::chrono::duration<double>(Pacer::Clock::now() - start).count();
+        std::cout << "Queries: " << names.size() << ", "
+        << "Answered: " << answered << ", "
+        << "Errors: " << errors << ", "
+        << "Timeouts: " << lost << ", "
+        << "Retries: " << retries << ", "
+        << "Goodput: " << (elapsed > 0 ? answered / elapsed : 0) << " qps, "
+        << "Window: " << (int) pacer.window << std::endl;
+    }
+};
+
+// parses DNS responses captured in pcap or pcapng file in parallel
+class PcapReader{
+public:
+    struct Payload {
+        size_t packet;          // number of packet in capture
+        const uint8_t *data;    // DNS message
+        int len;
+    };
+
+    Configuration config;
+    const uint8_t *file;
+    size_t fileLen;
+    bool swapped;               // file written with other byte order
+    size_t packets;
+    size_t records;
+    size_t malformed;
+    std::vector<Payload> payloads;
+
+    explicit PcapReader(Configuration conf) : config(conf) {
+        file = nullptr;
+        fileLen = 0;
+        swapped = false;
+        packets = 0;
+        records = 0;
+        malformed = 0;
+        if (config.threads < 1){
+            config.threads = std::max(1, (int) std::thread::hardware_concurrency());
+        }
+    }
+
+    ~PcapReader(){
+        if (file != nullptr){
+            munmap((void *) file, fileLen);
+        }
+    }
+
+    /**
+     * Maps capture file into memory
+     * @return True on success
+     */
+    bool Open(){
+        int fd = open(config.pcapFile, O_RDONLY);
+        struct stat info{};
+        if (fd == -1 || fstat(fd, &info) == -1){
+            std::cerr << "Failed opening file " << config.pcapFile << "!" << std::endl;
+            return false;
+        }
+
+        fileLen = info.st_size;
+        void *mapped = fileLen ? mmap(nullptr, fileLen, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapped == MAP_FAILED){
+            std::cerr << "Failed mapping file " << config.pcapFile << "!" << std::endl;
+            return false;
+        }
+        madvise(mapped, fileLen, MADV_SEQUENTIAL);
+        file = (const uint8_t *) mapped;
+        return true;
+    }
+
+    /**
+     * Finds DNS responses in capture and prints their records as csv
+     * @return False if file format is not recognized
+     */
+    bool Run(){
+        if (fileLen < sizeof(uint32_t)){
+            std::cerr << "Unknown capture format!" << std::endl;
+            return false;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::cout << "packet,section,name,type,class,ttl,data" << std::endl;
+
+        uint32_t magic;
+        memcpy(&magic, file, sizeof(uint32_t));
+        bool known;
+        if (magic == PCAPNG_SHB){
+            known = ScanPcapNg();
+        } else {
+            known = ScanPcap();
+        }
+        ParseBatch();
+
+        if (!known){
+            std::cerr << "Unknown capture format!" << std::endl;
+            return false;
+        }
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Packets: " << packets << ", "
+        << "Records: " << records << ", "
+        << "Malformed: " << malformed << ", "
+        << "Time: " << elapsed << " s, "
+        << "Records/s: " << (elapsed > 0 ? records / elapsed : 0) << std::endl;
+        return true;
+    }
+
+    /**
+     * Walks packet records of classic pcap file
+     * @return False if file is not pcap
+     */
+    bool ScanPcap(){
+        if (fileLen < PCAP_HEADER_LENGTH){
+            return false;
+        }
+
+        uint32_t magic;
+        memcpy(&magic, file, sizeof(uint32_t));
+        if (magic == PCAP_MAGIC || magic == PCAP_MAGIC_NS){
+            swapped = false;
+        } else if (__builtin_bswap32(magic) == PCAP_MAGIC || __builtin_bswap32(magic) == PCAP_MAGIC_NS){
+            swapped = true;
+        } else {
+            return false;
+        }
+
+        int linkType = (int) (Read32(&file[20]) & 0xFFFF);
+        size_t position = PCAP_HEADER_LENGTH;
+        while (position + PCAP_RECORD_LENGTH <= fileLen){
+            uint32_t capturedLen = Read32(&file[position + 8]);
+            position += PCAP_RECORD_LENGTH;
+            if (capturedLen > fileLen - position){
+                break;                                                  // truncated capture
+            }
+            AddFrame(&file[position], capturedLen, linkType);
+            position += capturedLen;
+        }
+        return true;
+    }
+
+    /**
+     * Walks blocks of pcapng file
+     * @return False if file is not pcapng
+     */
+    bool ScanPcapNg(){
+        std::vector<int> linkTypes;     // link type of every interface in current section
+        size_t position = 0;
+        while (position + 3 * sizeof(uint32_t) <= fileLen){
+            const uint8_t *block = &file[position];
+            uint32_t type;
+            memcpy(&type, block, sizeof(uint32_t));
+
+            if (type == PCAPNG_SHB){
+                uint32_t byteOrder;
+                memcpy(&byteOrder, &block[8], sizeof(uint32_t));
+                if (byteOrder != PCAPNG_BOM && __builtin_bswap32(byteOrder) != PCAPNG_BOM){
+                    return false;
+                }
+                swapped = byteOrder != PCAPNG_BOM;
+                linkTypes.clear();
+            }
+            type = Read32(block);
+
+            uint32_t blockLen = Read32(&block[4]);
+            if (blockLen < 3 * sizeof(uint32_t) || blockLen > fileLen - position){
+                break;                                                  // truncated capture
+            }
+
+            if (type == PCAPNG_IDB && blockLen >= 20){
+                linkTypes.push_back(Read16(&block[8]));
+            } else if (type == PCAPNG_EPB && blockLen >= 32){
+                uint32_t interface = Read32(&block[8]);
+                uint32_t capturedLen = Read32(&block[20]);
+                if (interface < linkTypes.size() && capturedLen <= blockLen - 32){
+                    AddFrame(&block[28], capturedLen, linkTypes[interface]);
+                }
+            } else if (type == PCAPNG_SPB && blockLen >= 16 && !linkTypes.empty()){
+                uint32_t capturedLen = std::min(Read32(&block[8]), blockLen - 16);
+                AddFrame(&block[12], capturedLen, linkTypes[0]);
+            }
+            position += blockLen;
+        }
+        return true;
+    }
+
+    /**
+     * Finds UDP/53 payload in captured frame and queues it for parsing
+     * @param frame captured data
+     * @param len length of captured data
+     * @param linkType link layer header type
+     */
+    void AddFrame(const uint8_t *frame, uint32_t len, int linkType){
+        packets++;
+        uint32_t position;
+        uint16_t etherType;
+
+        // link layer
+        switch (linkType) {
+            case LINKTYPE_ETHERNET:
+                if (len < 14){
+                    return;
+                }
+                etherType = Read16Net(&frame[12]);
+                position = 14;
+                while ((etherType == ETHERTYPE_VLAN || etherType == ETHERTYPE_QINQ) && position + 4 <= len){
+                    etherType = Read16Net(&frame[position + 2]);
+                    position += 4;
+                }
+                break;
+            case LINKTYPE_NULL:
+                if (len < 4){
+                    return;
+                }
+                etherType = (frame[0] == AF_INET || frame[3] == AF_INET) ? ETHERTYPE_IPV4 : ETHERTYPE_IPV6;
+                position = 4;
+                break;
+            case LINKTYPE_LINUX_SLL:
+                if (len < 16){
+                    return;
+                }
+                etherType = Read16Net(&frame[14]);
+                position = 16;
+                break;
+            case LINKTYPE_LINUX_SLL2:
+                if (len < 20){
+                    return;
+                }
+                etherType = Read16Net(&frame[0]);
+                position = 20;
+                break;
+            case LINKTYPE_RAW:
+            case LINKTYPE_IPV4:
+            case LINKTYPE_IPV6:
+                if (len < 1){
+                    return;
+                }
+                etherType = (frame[0] >> 4) == 4 ? ETHERTYPE_IPV4 : ETHERTYPE_IPV6;
+                position = 0;
                 break;
             default:
-                std::cout << "Unknown DNS class";
+                return;
+        }
+
+        // network layer
+        uint32_t end = len;
+        uint8_t protocol;
+        if (etherType == ETHERTYPE_IPV4){
+            if (position + 20 > len){
+                return;
+            }
+            if (Read16Net(&frame[position + 6]) & 0x3FFF){             // fragments are not reassembled
+                return;
+            }
+            end = std::min(end, position + Read16Net(&frame[position + 2]));
+            protocol = frame[position + 9];
+            position += (frame[position] & 0x0F) * 4;
+        } else if (etherType == ETHERTYPE_IPV6){
+            if (position + 40 > len){
+                return;
+            }
+            end = std::min(end, position + 40 + Read16Net(&frame[position + 4]));
+            protocol = frame[position + 6];
+            position += 40;
+        } else {
+            return;
+        }
+
+        // transport layer
+        if (protocol != IPPROTO_UDP || position + 8 > end){
+            return;
+        }
+        if (Read16Net(&frame[position]) != 53 && Read16Net(&frame[position + 2]) != 53){
+            return;
+        }
+        end = std::min(end, position + Read16Net(&frame[position + 4]));
+        position += 8;
+
+        // DNS responses only (QR bit)
+        if (end < position + sizeof(DNSHeader) || !(frame[position + 2] & 0x80)){
+            return;
+        }
+
+        payloads.push_back(Payload{packets, &frame[position], (int) (end - position)});
+        if (payloads.size() >= (size_t) config.threads * PCAP_BATCH){
+            ParseBatch();
+        }
+    }
+
+    /**
+     * Parses queued payloads split among threads and prints the results in capture order
+     */
+    void ParseBatch(){
+        if (payloads.empty()){
+            return;
         }
+
+        int threads = config.threads;
+        size_t chunk = (payloads.size() + threads - 1) / threads;
+        std::vector<std::string> outputs(threads);
+        std::vector<size_t> threadRecords(threads, 0);
+        std::vector<size_t> threadMalformed(threads, 0);
+        std::vector<std::thread> workers;
+
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t](){
+                std::ostringstream packetOutput;        // rows of malformed packet are dropped
+                Resolver resolver = Resolver();
+                resolver.out = &packetOutput;
+                resolver.csv = true;
+                size_t last = std::min(payloads.size(), (t + 1) * chunk);
+                for (size_t i = t * chunk; i < last; ++i) {
+                    resolver.answer = (uint8_t *) payloads[i].data;
+                    resolver.answerLen = payloads[i].len;
+                    resolver.packet = payloads[i].packet;
+                    packetOutput.str("");
+                    if (resolver.ParseAnswer(true)){
+                        outputs[t] += packetOutput.str();
+                        DNSHeader answerHeader = DNSHeader();
+                        memcpy(&answerHeader, payloads[i].data, sizeof(answerHeader));
+                        threadRecords[t] += ntohs(answerHeader.ANCount) + ntohs(answerHeader.NSCount) + ntohs(answerHeader.ARCount);
+                    } else {
+                        threadMalformed[t]++;
+                    }
+                }
+                resolver.answer = nullptr;      // owned by mapped file
+            });
+        }
+
+        for (int t = 0; t < threads; ++t) {
+            workers[t].join();
+            std::cout << outputs[t];
+            records += threadRecords[t];
+            malformed += threadMalformed[t];
+        }
+        payloads.clear();
+    }
+
+    uint32_t Read32(const uint8_t *src) const{
+        uint32_t value;
+        memcpy(&value, src, sizeof(uint32_t));
+        return swapped ? __builtin_bswap32(value) : value;
+    }
+
+    uint16_t Read16(const uint8_t *src) const{
+        uint16_t value;
+        memcpy(&value, src, sizeof(uint16_t));
+        return swapped ? __builtin_bswap16(value) : value;
+    }
+
+    static uint16_t Read16Net(const uint8_t *src){
+        uint16_t value;
+        memcpy(&value, src, sizeof(uint16_t));
+        return ntohs(value);
     }
 };
 
@@ -697,10 +1863,20 @@ int main(int argc, char* argv[]) {
     // parsing command line arguments
     Configuration config;
     if (!config.ParseArgs(argc, argv)){
-        std::cout << "Usage: dns [-r] [-x] [-6] -s server [-p port] adresa" << std::endl;
+        std::cout << "Usage: dns [-r] [-x] [-6] -s server [-p port] [-b file [-q qps]] [-z] adresa" << std::endl;
+        std::cout << "       dns -f capture.pcap [-j threads]   (records as RFC 4180 csv)" << std::endl;
         return EXIT_FAILURE;
     }
 
+    // parsing captured answers
+    if (config.pcapFile != nullptr){
+        PcapReader reader(config);
+        if (!reader.Open() || !reader.Run()){
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+
     struct in_addr ipBuffer{};
     struct in6_addr ipv6Buffer{};
     if (inet_pton(AF_INET, config.server, &ipBuffer) != 1 && inet_pton(AF_INET6, config.server, &ipv6Buffer) != 1){       // server is not ip address
@@ -713,16 +1889,36 @@ int main(int argc, char* argv[]) {
         Resolver serverResolver = Resolver();
         serverResolver.Configure(serverConf);
         serverResolver.SendQuestion();
-        serverResolver.ParseAnswer(false);
+        if (!serverResolver.ParseAnswer(false) || serverResolver.ip[0] == 0){
+            std::cerr << "Failed resolving server address!" << std::endl;
+            return EXIT_FAILURE;
+        }
         config.server = new char[16];
         strcpy(config.server, serverResolver.ip);
     }
 
+    // resolving every name from file
+    if (config.bulkFile != nullptr){
+        BulkResolver bulkResolver(config);
+        if (!bulkResolver.LoadNames()){
+            return EXIT_FAILURE;
+        }
+        bulkResolver.Run();
+        return 0;
+    }
+
     // resolving user query
     Resolver resolver = Resolver();
     resolver.Configure(config);
+    if (config.transfer){
+        resolver.TransferZone();
+        return 0;
+    }
     resolver.SendQuestion();
-    resolver.ParseAnswer(true);
+    if (!resolver.ParseAnswer(true)){
+        std::cerr << "Malformed answer!" << std::endl;
+        return EXIT_FAILURE;
+    }
 
     return 0;
 }
@@ -29,3 +29,19 @@ echo "./dns -6 -r www.google.com"
 echo "-------test 8: nevalidní vstup-------"
 echo "./dns -s -6 -r www.google.com"
 ./dns -s -6 -r www.google.com
+
+echo "---------test 9: zone transfer--------"
+echo "./dns -s nsztm1.digi.ninja -z zonetransfer.me"
+./dns -s nsztm1.digi.ninja -z zonetransfer.me
+
+echo "---------test 10: bulk queries--------"
+printf "www.fit.vut.cz\nwww.github.com\ngoogle.com\n" > names.txt
+echo "./dns -s 1.1.1.1 -r -b names.txt -q 2"
+./dns -s 1.1.1.1 -r -b names.txt -q 2
+rm -f names.txt
+
+echo "---------test 11: offline capture with malformed packet--------"
+printf '\324\303\262\241\002\000\004\000\000\000\000\000\000\000\000\000\377\377\000\000\145\000\000\000\000\000\000\000\000\000\000\000\123\000\000\000\123\000\000\000\105\000\000\123\000\000\000\000\100\021\000\000\012\000\000\001\012\000\000\002\000\065\234\100\000\077\000\000\000\002\201\200\000\001\000\002\000\000\000\000\002\156\163\002\143\172\000\000\001\000\001\300\014\000\001\000\001\000\000\000\074\000\004\012\000\000\001\300\014\000\001\000\001\000\000\000\074\000\005\012\000\000\001\000\000\000\000\000\000\000\000\103\000\000\000\103\000\000\000\105\000\000\103\000\000\000\000\100\021\000\000\012\000\000\001\012\000\000\002\000\065\234\100\000\057\000\000\000\001\201\200\000\001\000\001\000\000\000\000\002\156\163\002\143\172\000\000\001\000\001\300\014\000\001\000\001\000\000\000\074\000\004\012\000\000\001' > malformed.pcap
+echo "./dns -f malformed.pcap"
+./dns -f malformed.pcap
+rm -f malformed.pcap